@@ -14,10 +14,14 @@ TEMPLATE = app
 
 SOURCES += main.cpp\
         mainwindow.cpp \
-    oscilloscope.cpp
+    oscilloscope.cpp \
+    samplestore.cpp \
+    segmentstore.cpp
 
 HEADERS  += mainwindow.h \
-    oscilloscope.h
+    oscilloscope.h \
+    samplestore.h \
+    segmentstore.h
 
 FORMS    += mainwindow.ui
 
@@ -5,8 +5,11 @@
 #include <QPainter>
 #include <QPaintEvent>
 
+#include <limits.h>
+
 Oscilloscope::Oscilloscope(QWidget *parent) :
-    QWidget(parent)
+    QWidget(parent), sampleStore(0), samplesPerPixel(1),
+    segmentStore(0), currentSegment(0), overlay(false)
 {
     setFocusPolicy(Qt::StrongFocus);
 
@@ -120,6 +123,145 @@ void Oscilloscope::moveViewport(const QPoint &delta)
 
 
 
+void Oscilloscope::setSampleStore(const SampleStore *store)
+{
+    sampleStore = store;
+    updateMaximumViewport();
+}
+
+
+
+void Oscilloscope::setHorizontalScale(int scale)
+{
+
+    // Rescale around the left edge of the viewport, such that the first visible sample stays
+    // where it is, as far as the extent of the data permits.
+
+    scale = qMax(scale, 1);
+    currentViewport.moveLeft((int) ((qint64) currentViewport.left() * samplesPerPixel / scale));
+    samplesPerPixel = scale;
+    updateMaximumViewport();
+}
+
+
+
+void Oscilloscope::samplesChanged()
+{
+
+    // To be called by the acquisition side whenever samples have been appended to, or cleared
+    // from the store. The widget cannot tell otherwise, and would keep scrolling stale pixels.
+
+    updateMaximumViewport();
+}
+
+
+
+void Oscilloscope::updateMaximumViewport()
+{
+
+    // The maximum viewport spans all the data at the current horizontal scale, i.e., the whole
+    // history of the sample store, or a single segment if a segment store is set, but is never
+    // narrower than the plot-area. Without any data, it keeps its initial extent. The current
+    // viewport is then pushed back inside, should it have been left beyond the new extremes,
+    // unless it has not been laid out yet, which only happens before the first resize.
+
+    qint64 extent = maximumViewport.width();
+    if (sampleStore != 0) extent = (sampleStore->count() + samplesPerPixel - 1) / samplesPerPixel;
+    if (segmentStore != 0) extent = (segmentStore->length() + samplesPerPixel - 1) / samplesPerPixel;
+    extent = qBound((qint64) currentViewport.width(), extent, (qint64) INT_MAX / 2);
+    maximumViewport.setWidth((int) extent);
+    if (!currentViewport.isValid()) return;
+
+    if (currentViewport.right() > maximumViewport.right()) currentViewport.moveRight(maximumViewport.right());
+    if (currentViewport.left() < maximumViewport.left()) currentViewport.moveLeft(maximumViewport.left());
+    if (currentViewport.bottom() > maximumViewport.bottom()) currentViewport.moveBottom(maximumViewport.bottom());
+    if (currentViewport.top() < maximumViewport.top()) currentViewport.moveTop(maximumViewport.top());
+
+    for (int index = 0; index < cursors.count(); index++)
+        updateMarkerGeometry(cursors.value(index));
+
+    update();
+}
+
+
+
+void Oscilloscope::setSegmentStore(const SegmentStore *store)
+{
+
+    // While a segment store is set, it takes precedence over the continuous sample store, and
+    // the view shows one segment at a time, or all of them at once if the overlay is enabled.
+
+    segmentStore = store;
+    currentSegment = 0;
+    updateMaximumViewport();
+    emit segmentChanged(currentSegment);
+}
+
+
+
+void Oscilloscope::segmentsChanged()
+{
+
+    // To be called by the acquisition side after segments have been committed to, or cleared
+    // from the segment store. If the store now holds fewer segments than before, the view
+    // falls back to the last one available.
+
+    if (segmentStore != 0 && currentSegment > 0 && currentSegment >= segmentStore->count()) {
+        currentSegment = qMax(segmentStore->count() - 1, 0);
+        emit segmentChanged(currentSegment); }
+
+    updateMaximumViewport();
+}
+
+
+
+void Oscilloscope::showSegment(int segment)
+{
+    if (segmentStore == 0 || segment < 0 || segment >= segmentStore->count()) return;
+    if (segment == currentSegment) return;
+
+    currentSegment = segment;
+    update();
+    emit segmentChanged(segment);
+}
+
+
+
+void Oscilloscope::setOverlay(bool isOverlaid)
+{
+    overlay = isOverlaid;
+    update();
+}
+
+
+
+SampleStore::Envelope Oscilloscope::traceEnvelope(qint64 first, qint64 count) const
+{
+    if (segmentStore != 0) {
+        if (first >= segmentStore->length()) return SampleStore::Envelope::empty();
+        count = qMin(count, segmentStore->length() - first);
+        if (overlay) return segmentStore->overlayEnvelope((int) first, (int) count);
+        return segmentStore->envelope(qMin(currentSegment, segmentStore->count() - 1), (int) first, (int) count); }
+
+    if (sampleStore != 0) return sampleStore->envelope(first, count);
+    return SampleStore::Envelope::empty();
+}
+
+
+
+QString Oscilloscope::intervalText(qint64 nanoseconds)
+{
+
+    // Renders an interval in the largest unit that keeps at least one digit before the point.
+
+    if (qAbs(nanoseconds) < 1000) return QString("%1 ns").arg(nanoseconds);
+    if (qAbs(nanoseconds) < 1000000) return QString("%1 %2s").arg(nanoseconds / 1e3, 0, 'f', 3).arg(QChar(0x00b5));
+    if (qAbs(nanoseconds) < 1000000000) return QString("%1 ms").arg(nanoseconds / 1e6, 0, 'f', 3);
+    return QString("%1 s").arg(nanoseconds / 1e9, 0, 'f', 3);
+}
+
+
+
 void Oscilloscope::moveMarker(Marker *marker, const QPoint& delta)
 {
 
@@ -275,6 +417,9 @@ bool Oscilloscope::event(QEvent *event)
         if (keyEvent->key() == Qt::Key_S) moveViewport(QPoint(0 ,-1));
         if (keyEvent->key() == Qt::Key_A) moveViewport(QPoint(1, 0));
         if (keyEvent->key() == Qt::Key_D) moveViewport(QPoint(-1, 0));
+        if (keyEvent->key() == Qt::Key_PageUp) showSegment(currentSegment - 1);
+        if (keyEvent->key() == Qt::Key_PageDown) showSegment(currentSegment + 1);
+        if (keyEvent->key() == Qt::Key_O && segmentStore != 0) setOverlay(!overlay);
     default: ; }
 
     return QWidget::event(event);
@@ -293,8 +438,7 @@ void Oscilloscope::resizeEvent(QResizeEvent *event)
         0 - plotAreaMarginRight, 0 - plotAreaMarginBottom);
 
     currentViewport.setSize(plotAreaRect.size());
-    for (int index = 0; index < cursors.count(); index++)
-        updateMarkerGeometry(cursors.value(index));
+    updateMaximumViewport();
 
     // The following are rects in which scrolling is performed when the user moves the viewport.
 
@@ -458,6 +602,41 @@ void Oscilloscope::paintEvent(QPaintEvent *event)
         DRAW (QPoint(horizontalMinorOffset, verticalRulerOffset), y, x,
               verticalRulerStep, horizontalTicks, horizontalMinorDistance);
 
+        // The following code plots the waveform, one vertical line per pixel column spanning
+        // the envelope of the samples that fall into that column. When zoomed out beyond a block
+        // per column, the sample range is aligned to blocks, such that the envelope comes straight
+        // from the pyramid and no chunk is ever decompressed. Otherwise the range is extended by
+        // one sample to the left, which joins neighboring columns into a continuous trace.
+        // In overlay mode, the envelope is that of all segments united, which the segment
+        // store keeps up to date as segments are committed.
+
+        if (sampleStore != 0 || segmentStore != 0) {
+            traceLines.resize(0);
+
+            for (int x = viewportRect.left(); x <= viewportRect.right(); x++) {
+                qint64 first = (qint64) x * samplesPerPixel, last = first + samplesPerPixel;
+
+                if (samplesPerPixel >= SampleStore::blockLength) {
+                    first -= first % SampleStore::blockLength;
+                    last -= last % SampleStore::blockLength; }
+                else if (first > 0) first--;
+
+                SampleStore::Envelope envelope = traceEnvelope(first, last - first);
+                if (envelope.isEmpty()) continue;
+
+                // Clamp the line to the plot-area, otherwise it would spill into the tick marks,
+                // as the painter is only clipped to the border.
+
+                int top = maximumViewport.center().y() - envelope.maximum * maximumViewport.height() / 65536;
+                int bottom = maximumViewport.center().y() - envelope.minimum * maximumViewport.height() / 65536;
+                if (bottom < viewportRect.top() || top > viewportRect.bottom()) continue;
+
+                traceLines.append(QLine(x, qMax(top, viewportRect.top()), x, qMin(bottom, viewportRect.bottom()))); }
+
+            painter.setPen(Qt::green);
+            painter.drawLines(traceLines);
+            painter.setPen(Qt::white); }
+
         // The following code plots the tick marks that reside on the axe. These elements
         // differ different all others because one of their dimensions never changes,
         // as the viewport is being moved around.
@@ -493,6 +672,31 @@ void Oscilloscope::paintEvent(QPaintEvent *event)
 
     painter.restore();
 
+    // ===
+
+    // The caption of the segment browser, placed in the top margin above the plot-area and
+    // the tick marks. The interval is the difference between the trigger time stamps of the
+    // current segment and the one before it, which is what usually matters when looking for
+    // rare events. Nothing else paints the margin, and the widget paints opaquely, therefore
+    // the caption rect is always filled first, which also wipes the caption once it is gone.
+
+    QRect captionRect(plotAreaRect.left(), 0, plotAreaRect.width(), plotAreaMarginTop - tickMarkLength - 1);
+    painter.fillRect(captionRect, Qt::black);
+
+    // The segment store may have been refilled with fewer segments without segmentsChanged()
+    // having been called yet, hence the index is clamped here, but only locally.
+
+    if (segmentStore != 0 && segmentStore->count() > 0) {
+        int segment = qMin(currentSegment, segmentStore->count() - 1);
+        QString caption = overlay ? QString("%1 segments overlaid").arg(segmentStore->count()) :
+            QString("segment %1 / %2, +%3").arg(segment + 1).arg(segmentStore->count()).arg(intervalText(
+                segment > 0 ? segmentStore->timestamp(segment) - segmentStore->timestamp(segment - 1) : 0));
+
+        painter.save();
+        painter.setPen(Qt::white);
+        painter.drawText(captionRect, Qt::AlignRight | Qt::AlignVCenter, caption);
+        painter.restore(); }
+
 }
 
 
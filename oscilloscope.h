@@ -6,6 +6,9 @@
 #include <QBitmap>
 #include <QPaintEvent>
 
+#include "samplestore.h"
+#include "segmentstore.h"
+
 class Oscilloscope : public QWidget
 {
     Q_OBJECT
@@ -74,6 +77,11 @@ class Oscilloscope : public QWidget
 public:
     explicit Oscilloscope(QWidget *parent = 0);
     void moveViewport(const QPoint& delta);
+    void setSampleStore(const SampleStore *store);
+    void setHorizontalScale(int scale);
+    void setSegmentStore(const SegmentStore *store);
+    void showSegment(int segment);
+    void setOverlay(bool isOverlaid);
 
 protected:
     bool event(QEvent *event);
@@ -83,6 +91,9 @@ protected:
 private:
     void buildPaintCache();
     int updateMarkerGeometry(Marker *marker);
+    void updateMaximumViewport();
+    SampleStore::Envelope traceEnvelope(qint64 first, qint64 count) const;
+    static QString intervalText(qint64 nanoseconds);
 
     QVector<QPoint> verticalMajorDots;
     QVector<QPoint> horizontalMajorDots;
@@ -90,6 +101,7 @@ private:
     QVector<QPoint> horizontalMinorDots;
     QVector<QLine>  verticalTicks;
     QVector<QLine>  horizontalTicks;
+    QVector<QLine>  traceLines;
 
     const static int plotAreaMarginLeft = 31;
     const static int plotAreaMarginTop = 21;
@@ -119,13 +131,23 @@ private:
     QRect currentViewport;
     QRect maximumViewport;
 
+    const SampleStore *sampleStore;
+    int samplesPerPixel;
+
+    const SegmentStore *segmentStore;
+    int currentSegment;
+    bool overlay;
+
     QList<Marker*> cursors;
     Marker testMarker, testMarker2;
     Marker testMarker3, testMarker4;
 
 signals:
+    void segmentChanged(int segment);
 
 public slots:
+    void samplesChanged();
+    void segmentsChanged();
 
 };
 
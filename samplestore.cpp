@@ -0,0 +1,373 @@
+#include "samplestore.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+SampleStore::SampleStore(bool isCompressed) :
+    compressed(isCompressed)
+{
+    clear();
+}
+
+
+
+void SampleStore::clear()
+{
+    sampleCount = 0;
+    cacheClock = 0;
+
+    pageUsage = 0;
+
+    chunks.clear();
+    pages.clear();
+    pending.clear();
+    pyramid.clear();
+    cache.clear();
+
+    pending.reserve(chunkLength);
+    pyramid.append(QVector<Envelope>());
+}
+
+
+
+void SampleStore::append(const qint16 *samples, int count)
+{
+
+    // Samples are appended one block at a time, such that every time a block is completed,
+    // its envelope can be pushed to the bottom of the pyramid. Since a chunk always consists of
+    // whole blocks, the pending samples always begin at a block boundary as well.
+
+    while (count > 0) {
+        int span = qMin(count, blockLength - pending.count() % blockLength);
+        pending.resize(pending.count() + span);
+        memcpy(pending.data() + pending.count() - span, samples, span * sizeof(qint16));
+        sampleCount += span; samples += span; count -= span;
+
+        if (pending.count() % blockLength) continue;
+
+        Envelope envelope = Envelope::empty();
+        const qint16 *block = pending.constData() + pending.count() - blockLength;
+        for (int index = 0; index < blockLength; index++)
+            envelope.unite(block[index]);
+
+        // Push the new envelope to the bottom level, and whenever a level has got an even number
+        // of entries, the last two of them are united and pushed onto the level above.
+
+        pyramid[0].append(envelope);
+        for (int level = 0; pyramid[level].count() % 2 == 0; level++) {
+            if (level + 1 == pyramid.count()) pyramid.append(QVector<Envelope>());
+            envelope = pyramid[level].at(pyramid[level].count() - 2);
+            envelope.unite(pyramid[level].last());
+            pyramid[level + 1].append(envelope); }
+
+        if (pending.count() == chunkLength) seal(); }
+
+}
+
+
+
+void SampleStore::seal()
+{
+
+    // Every block of the chunk is encoded on its own, with whichever of the two predictors suits
+    // it better: the delta predictor guesses that the next sample equals the previous one, and
+    // the linear predictor extrapolates from the previous two, which suits slowly varying signals
+    // better. The residuals are zigzag-mapped, such that small negative values become small
+    // positive ones, and packed with patched frame-of-reference: the block gets a bit width that
+    // most of its residuals fit in, and the few that do not, such as the edges of a square wave,
+    // are stored as exceptions that patch in their high bits. If neither predictor beats storing
+    // the samples as they are, or compression is disabled altogether, the block is stored raw.
+
+    // The payload of a chunk starts with the headers of its blocks, two per word, followed by
+    // the packed residuals and the exceptions of each block in turn. The predictors carry over
+    // from one block to the next, and start off the origin of the chunk.
+
+#define ZIGZAG(R) (((quint32) (R) << 1) ^ (quint32) ((R) >> 31))
+
+    const qint16 *samples = pending.constData();
+    quint32 payload[blocksPerChunk / 2 + blocksPerChunk * blockLength / 2];
+    quint32 residuals[2][blockLength];
+    int length = blocksPerChunk / 2;
+    int previous = samples[0], secondPrevious = samples[0];
+
+    memset(payload, 0, sizeof(payload));
+
+    for (int block = 0; block < blocksPerChunk; block++) {
+        const qint16 *source = samples + block * blockLength;
+        int predictor = Raw, bitWidth = 16, exceptionCount = 0, cost = 16 * blockLength;
+
+        // Find the cheapest encoding by counting the residuals of every bit length. A width
+        // of bitWidth bits then costs bitWidth bits per sample, plus one word per residual
+        // that is longer than that.
+
+        for (int candidate = Delta; candidate <= Linear && compressed; candidate++) {
+            int histogram[20] = { 0 }, first = previous, second = secondPrevious;
+
+            for (int index = 0; index < blockLength; index++) {
+                int residual = candidate == Delta ? source[index] - first : source[index] - 2 * first + second;
+                quint32 value = residuals[candidate - Delta][index] = ZIGZAG(residual);
+                int bits = 0; while (value >> bits) bits++;
+                histogram[bits]++;
+                second = first; first = source[index]; }
+
+            for (int width = 0, longer = blockLength - histogram[0]; width < 16; longer -= histogram[++width]) {
+                if (width * blockLength + longer * 32 >= cost) continue;
+                cost = width * blockLength + longer * 32;
+                predictor = candidate; bitWidth = width; exceptionCount = longer; } }
+
+        // Lay out the block. The residuals are distributed over the lanes round robin, and each
+        // lane is packed on its own, with the words of all lanes interleaved. Thus the lanes share
+        // the same bit offsets, and the decoder can unpack them side by side.
+
+        quint32 *destination = payload + length, values[blockLength];
+        quint32 mask = (1u << bitWidth) - 1;
+        payload[block >> 1] |= (quint32) (bitWidth | exceptionCount << 5 | predictor << 13) << ((block & 1) * 16);
+
+        for (int index = 0; index < blockLength; index++)
+            values[index] = predictor == Raw ? (quint16) source[index] : residuals[predictor - Delta][index];
+
+        for (int index = 0; index < blockLength && bitWidth > 0; index++) {
+            int bit = (index / laneCount) * bitWidth, lane = index % laneCount;
+            quint32 value = values[index] & mask;
+            destination[(bit >> 5) * laneCount + lane] |= value << (bit & 31);
+            if ((bit & 31) + bitWidth > 32)
+                destination[((bit >> 5) + 1) * laneCount + lane] |= value >> (32 - (bit & 31)); }
+
+        length += bitWidth * blockLength / 32;
+
+        for (int index = 0; index < blockLength && exceptionCount > 0; index++)
+            if (values[index] >> bitWidth) payload[length++] = (values[index] >> bitWidth) | index << 24;
+
+        previous = source[blockLength - 1];
+        secondPrevious = source[blockLength - 2]; }
+
+#undef ZIGZAG
+
+    Chunk chunk;
+    chunk.origin = samples[0];
+    memcpy(allocate(&chunk, length), payload, length * sizeof(quint32));
+
+    chunks.append(chunk);
+    pending.clear();
+}
+
+
+
+quint32 *SampleStore::allocate(Chunk *chunk, int wordCount)
+{
+
+    // Chunks are laid out back to back in the last page. A chunk that does not fit into what is
+    // left of it starts a new page instead; the few words wasted at the end are negligible.
+
+    if (pages.isEmpty() || pageUsage + wordCount > pageLength) {
+        pages.append(QVector<quint32>(pageLength));
+        pageUsage = 0; }
+
+    chunk->page = pages.count() - 1;
+    chunk->offset = pageUsage;
+    pageUsage += wordCount;
+    return pages.last().data() + chunk->offset;
+}
+
+
+
+void SampleStore::unpack(const quint32 *source, int bitWidth, quint32 *values)
+{
+
+    // Unpacks the residuals of a block. As all lanes share the same bit offsets, each group of
+    // laneCount residuals is extracted from laneCount contiguous words by shifting all of them
+    // by the same amount, which maps directly onto a single 128-bit vector of 32-bit integers.
+    // Compilers do not vectorize this on their own, so it is spelled out for SSE2 and NEON,
+    // with a plain loop over the lanes for everything else.
+
+    quint32 mask = (1u << bitWidth) - 1;
+
+    if (bitWidth == 0) {
+        for (int index = 0; index < blockLength; index++) values[index] = 0;
+        return; }
+
+    for (int position = 0; position < blockLength / laneCount; position++) {
+        int bit = position * bitWidth, shift = bit & 31;
+        const quint32 *low = source + (bit >> 5) * laneCount, *high = low + laneCount;
+        quint32 *destination = values + position * laneCount;
+
+#if defined(__SSE2__) || defined(_M_X64)
+
+        __m128i value = _mm_srl_epi32(_mm_loadu_si128((const __m128i *) low), _mm_cvtsi32_si128(shift));
+        if (shift + bitWidth > 32) value = _mm_or_si128(value,
+            _mm_sll_epi32(_mm_loadu_si128((const __m128i *) high), _mm_cvtsi32_si128(32 - shift)));
+        _mm_storeu_si128((__m128i *) destination, _mm_and_si128(value, _mm_set1_epi32((int) mask)));
+
+#elif defined(__ARM_NEON)
+
+        uint32x4_t value = vshlq_u32(vld1q_u32(low), vdupq_n_s32(-shift));
+        if (shift + bitWidth > 32) value = vorrq_u32(value, vshlq_u32(vld1q_u32(high), vdupq_n_s32(32 - shift)));
+        vst1q_u32(destination, vandq_u32(value, vdupq_n_u32(mask)));
+
+#else
+
+        for (int lane = 0; lane < laneCount; lane++)
+            destination[lane] = ((low[lane] >> shift) | (shift + bitWidth > 32 ? high[lane] << (32 - shift) : 0)) & mask;
+
+#endif
+
+    }
+
+}
+
+
+
+void SampleStore::decode(int chunk, qint16 *destination) const
+{
+    const Chunk& descriptor = chunks.at(chunk);
+    const quint32 *headers = pages.at(descriptor.page).constData() + descriptor.offset;
+    const quint32 *source = headers + blocksPerChunk / 2;
+    int previous = descriptor.origin, secondPrevious = descriptor.origin;
+
+    // Every block is decoded in three passes: the residuals are unpacked, the exceptions patch
+    // in the high bits of the residuals that did not fit, and finally the predictor is run,
+    // which is inherently sequential but trivially cheap.
+
+    for (int block = 0; block < blocksPerChunk; block++, destination += blockLength) {
+        quint32 header = headers[block >> 1] >> ((block & 1) * 16), values[blockLength];
+        int bitWidth = header & 31, exceptionCount = (header >> 5) & 255, predictor = (header >> 13) & 3;
+
+        unpack(source, bitWidth, values);
+        source += bitWidth * blockLength / 32;
+
+        for (int index = 0; index < exceptionCount; index++, source++)
+            values[*source >> 24] |= (*source & 0xffffff) << bitWidth;
+
+        if (predictor == Raw)
+            for (int index = 0; index < blockLength; index++)
+                destination[index] = (qint16) values[index];
+
+        else if (predictor == Delta)
+            for (int index = 0; index < blockLength; index++)
+                previous = destination[index] = (qint16) (((values[index] >> 1) ^ (0 - (values[index] & 1))) + previous);
+
+        else for (int index = 0; index < blockLength; index++) {
+            int sample = (int) ((values[index] >> 1) ^ (0 - (values[index] & 1))) + 2 * previous - secondPrevious;
+            destination[index] = (qint16) sample;
+            secondPrevious = previous; previous = sample; }
+
+        previous = destination[blockLength - 1];
+        secondPrevious = destination[blockLength - 2]; }
+
+}
+
+
+
+const qint16 *SampleStore::decodedChunk(int chunk) const
+{
+
+    // A tiny least-recently-used cache of decoded chunks. When zoomed in, consecutive paint
+    // events keep asking for the same handful of chunks, so a linear search is good enough.
+
+    int victim = 0;
+
+    for (int index = 0; index < cache.count(); index++) {
+        if (cache.at(index).chunk == chunk) {
+            cache[index].lastUsed = ++cacheClock;
+            return cache.at(index).samples.constData(); }
+        if (cache.at(index).lastUsed < cache.at(victim).lastUsed) victim = index; }
+
+    if (cache.count() < cacheCapacity) {
+        victim = cache.count();
+        cache.append(CacheEntry());
+        cache[victim].samples.resize(chunkLength); }
+
+    CacheEntry& entry = cache[victim];
+    entry.chunk = chunk;
+    entry.lastUsed = ++cacheClock;
+    decode(chunk, entry.samples.data());
+    return entry.samples.constData();
+}
+
+
+
+int SampleStore::read(qint64 first, int count, qint16 *destination) const
+{
+    if (first < 0 || first >= sampleCount) return 0;
+    count = (int) qMin((qint64) count, sampleCount - first);
+
+    // The pending samples always begin right after the last sealed chunk, so that they can
+    // be addressed as if they formed yet another chunk.
+
+    for (int remaining = count; remaining > 0; ) {
+        int chunk = (int) (first / chunkLength), offset = (int) (first % chunkLength);
+        int span = qMin(remaining, chunkLength - offset);
+        const qint16 *source = chunk < chunks.count() ? decodedChunk(chunk) : pending.constData();
+        memcpy(destination, source + offset, span * sizeof(qint16));
+        destination += span; first += span; remaining -= span; }
+
+    return count;
+}
+
+
+
+void SampleStore::scan(qint64 first, qint64 count, Envelope *envelope) const
+{
+    qint16 buffer[blockLength];
+
+    while (count > 0) {
+        int span = read(first, (int) qMin((qint64) blockLength, count), buffer);
+        for (int index = 0; index < span; index++) envelope->unite(buffer[index]);
+        first += span; count -= span; }
+
+}
+
+
+
+SampleStore::Envelope SampleStore::envelope(qint64 first, qint64 count) const
+{
+    Envelope envelope = Envelope::empty();
+    qint64 last = qMin(first + count, sampleCount); first = qMax(first, (qint64) 0);
+    if (first >= last) return envelope;
+
+    // The range is split into a head and a tail that do not cover whole blocks, and have to be
+    // scanned sample by sample, and whole blocks in between, which are looked up in the pyramid.
+    // Callers that align their ranges to blocks therefore never cause any chunk to be decoded.
+
+    qint64 firstBlock = (first + blockLength - 1) / blockLength;
+    qint64 lastBlock = last / blockLength;
+
+    if (firstBlock >= lastBlock) {
+        scan(first, last - first, &envelope);
+        return envelope; }
+
+    scan(first, firstBlock * blockLength - first, &envelope);
+    scan(lastBlock * blockLength, last - lastBlock * blockLength, &envelope);
+
+    // Walk the blocks greedily, each time climbing as high in the pyramid as the alignment
+    // of the current block and the remaining extent permit.
+
+    for (qint64 block = firstBlock; block < lastBlock; ) {
+        int level = 0;
+        while (level + 1 < pyramid.count() && block % ((qint64) 2 << level) == 0 &&
+               block + ((qint64) 2 << level) <= lastBlock) level++;
+        envelope.unite(pyramid.at(level).at((int) (block >> level)));
+        block += (qint64) 1 << level; }
+
+    return envelope;
+}
+
+
+
+qint64 SampleStore::memoryUsage() const
+{
+    qint64 usage = (qint64) pages.count() * pageLength * sizeof(quint32)
+                 + (qint64) chunks.capacity() * sizeof(Chunk)
+                 + (qint64) pending.capacity() * sizeof(qint16)
+                 + (qint64) cache.count() * chunkLength * sizeof(qint16);
+
+    for (int level = 0; level < pyramid.count(); level++)
+        usage += (qint64) pyramid.at(level).capacity() * sizeof(Envelope);
+
+    return usage;
+}
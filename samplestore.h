@@ -0,0 +1,114 @@
+#ifndef SAMPLESTORE_H
+#define SAMPLESTORE_H
+
+#include <QVector>
+#include <QtGlobal>
+
+class SampleStore
+{
+
+    // The sample store keeps the entire acquisition history of a single channel in memory.
+    // Samples are appended in chunks of fixed length. Once a chunk is full, it is sealed,
+    // and if compression is enabled, each of its blocks is encoded with a predictor followed by
+    // bit-packing. How much that saves depends on the noise floor of the signal: a smooth signal
+    // with a couple of bits of noise, or a square wave, shrinks by a factor of three or more
+    // including the pyramid below, while full-scale noise does not shrink at all. The chunks are
+    // kept in pages of fixed size that are never moved, such that growing the history never
+    // copies it.
+
+    // Alongside the samples we maintain a min/max pyramid, whose bottom level holds the
+    // envelope of every block of samples and each level above it the envelope of two
+    // neighboring entries below. The pyramid is never compressed, such that zoomed-out views
+    // can be plotted without touching the samples at all. It costs about a sixteenth of the
+    // raw size of the samples, whether they are compressed or not.
+
+public:
+
+    struct Envelope {
+
+        qint16 minimum;
+        qint16 maximum;
+
+        // An empty envelope has its extremes inverted, such that uniting it
+        // with any sample or any other envelope yields the other operand.
+
+        static Envelope empty() {
+            Envelope instance;
+            instance.minimum = 32767;
+            instance.maximum = -32768;
+            return instance; }
+
+        bool isEmpty() const { return minimum > maximum; }
+
+        void unite(qint16 sample) {
+            if (sample < minimum) minimum = sample;
+            if (sample > maximum) maximum = sample; }
+
+        void unite(const Envelope& other) {
+            if (other.minimum < minimum) minimum = other.minimum;
+            if (other.maximum > maximum) maximum = other.maximum; }
+    };
+
+    explicit SampleStore(bool isCompressed = true);
+
+    void clear();
+    void append(const qint16 *samples, int count);
+
+    int read(qint64 first, int count, qint16 *destination) const;
+    Envelope envelope(qint64 first, qint64 count) const;
+
+    qint64 count() const { return sampleCount; }
+    qint64 memoryUsage() const;
+    bool isCompressed() const { return compressed; }
+
+    const static int blockLength = 128;
+    const static int chunkLength = 1024;
+    const static int blocksPerChunk = chunkLength / blockLength;
+    const static int cacheCapacity = 8;
+    const static int pageLength = 16384;    // in words.
+
+private:
+
+    // A sealed chunk. The payload lives in one of the pages, starting at offset, and consists
+    // of one header of 16 bits per block, followed by the blocks themselves. A header holds the
+    // bit width of the block in bits 0 to 4, the number of its exceptions in bits 5 to 12, and
+    // its predictor in bits 13 and 14. Within a block, the residuals are packed in laneCount
+    // interleaved lanes, which is what allows the decoder to be vectorized.
+
+    enum Predictor { Raw = 0, Delta = 1, Linear = 2 };
+
+    const static int laneCount = 4;         // 32-bit lanes of a 128-bit vector.
+
+    struct Chunk {
+        int page;
+        int offset;
+        qint16 origin;          // the first sample, from which the predictors start.
+    };
+
+    struct CacheEntry {
+        int chunk;
+        quint32 lastUsed;
+        QVector<qint16> samples;
+    };
+
+    void seal();
+    quint32 *allocate(Chunk *chunk, int wordCount);
+    void scan(qint64 first, qint64 count, Envelope *envelope) const;
+    void decode(int chunk, qint16 *destination) const;
+    static void unpack(const quint32 *source, int bitWidth, quint32 *values);
+    const qint16 *decodedChunk(int chunk) const;
+
+    bool compressed;
+    qint64 sampleCount;
+
+    QVector<Chunk> chunks;
+    QVector<QVector<quint32> > pages;
+    int pageUsage;                          // words taken in the last page.
+    QVector<qint16> pending;                 // samples of the chunk that is not yet sealed.
+    QVector<QVector<Envelope> > pyramid;     // pyramid[0] holds one envelope per block.
+
+    mutable quint32 cacheClock;
+    mutable QVector<CacheEntry> cache;
+};
+
+#endif // SAMPLESTORE_H
@@ -0,0 +1,167 @@
+#include "segmentstore.h"
+
+#include <string.h>
+
+SegmentStore::SegmentStore(int length, int capacity) :
+    segmentLength(clampedLength(length)),
+    segmentCapacity(clampedCapacity(length, capacity))
+{
+
+    // The capacity is clamped such that the arena never exceeds its maximum length, so callers
+    // asking for more should check capacity() afterwards. The last block of a segment may be
+    // partial if the segment length is not a multiple of the block length. Everything is
+    // allocated here and never resized afterwards.
+
+    blocksPerSegment = (segmentLength + blockLength - 1) / blockLength;
+
+    samples.resize(segmentLength * segmentCapacity);
+    timestamps.resize(segmentCapacity);
+    blocks.resize(blocksPerSegment * segmentCapacity);
+    overlaySamples.resize(segmentLength);
+    overlayBlocks.resize(blocksPerSegment);
+
+    clear();
+}
+
+
+
+int SegmentStore::clampedLength(int length)
+{
+    return qBound(1, length, (int) maximumArenaLength);
+}
+
+
+
+int SegmentStore::clampedCapacity(int length, int capacity)
+{
+    return qBound(1, capacity, (int) maximumArenaLength / clampedLength(length));
+}
+
+
+
+void SegmentStore::clear()
+{
+
+    // Clearing only forgets about the recorded segments; the arena itself is kept.
+
+    segmentCount = 0;
+    envelopedCount = 0;
+    overlaySamples.fill(Envelope::empty());
+    overlayBlocks.fill(Envelope::empty());
+}
+
+
+
+qint16 *SegmentStore::arm()
+{
+
+    // Returns the slot into which the next segment is to be acquired, or null if the arena
+    // is full. The slot is not considered recorded until it is committed, so arming again
+    // without committing simply hands out the same slot.
+
+    if (isFull()) return 0;
+    return samples.data() + (qint64) segmentCount * segmentLength;
+}
+
+
+
+void SegmentStore::commit(qint64 timestamp)
+{
+    if (isFull()) return;
+    timestamps[segmentCount++] = timestamp;
+}
+
+
+
+bool SegmentStore::record(const qint16 *samples, qint64 timestamp)
+{
+    qint16 *destination = arm();
+    if (destination == 0) return false;
+
+    memcpy(destination, samples, segmentLength * sizeof(qint16));
+    commit(timestamp);
+    return true;
+}
+
+
+
+const qint16 *SegmentStore::segment(int segment) const
+{
+    return samples.constData() + (qint64) segment * segmentLength;
+}
+
+
+
+void SegmentStore::updateEnvelopes() const
+{
+
+    // Computes the block envelopes of the segments committed since the last call,
+    // and unites them into the overlay.
+
+    Envelope *overlay = overlaySamples.data();
+
+    for (; envelopedCount < segmentCount; envelopedCount++) {
+        const qint16 *source = segment(envelopedCount);
+        Envelope *envelopes = blocks.data() + (qint64) envelopedCount * blocksPerSegment;
+
+        for (int block = 0; block < blocksPerSegment; block++) {
+            int first = block * blockLength, last = qMin(first + blockLength, segmentLength);
+            envelopes[block] = Envelope::empty();
+            for (int index = first; index < last; index++) {
+                envelopes[block].unite(source[index]);
+                overlay[index].unite(source[index]); }
+            overlayBlocks[block].unite(envelopes[block]); } }
+
+}
+
+
+
+template <typename Sample>
+SegmentStore::Envelope SegmentStore::span(const Sample *samples, const Envelope *envelopes,
+                                          int length, int first, int count)
+{
+
+    // Same as with the sample store, the samples of the head and the tail are scanned, while
+    // whole blocks in between are looked up in the cache. Segments are short and kept raw,
+    // so a single level of block envelopes is enough. The samples are either those of a single
+    // segment, or the per-sample envelopes of the overlay; both can be united alike.
+
+    Envelope envelope = Envelope::empty();
+    int last = qMin(first + count, length); first = qMax(first, 0);
+    if (first >= last) return envelope;
+
+    int blockCount = (length + blockLength - 1) / blockLength;
+    int firstBlock = (first + blockLength - 1) / blockLength;
+    int lastBlock = last == length ? blockCount : last / blockLength;
+
+    if (firstBlock >= lastBlock) {
+        for (int index = first; index < last; index++) envelope.unite(samples[index]);
+        return envelope; }
+
+    for (int index = first; index < firstBlock * blockLength; index++) envelope.unite(samples[index]);
+    for (int index = lastBlock * blockLength; index < last; index++) envelope.unite(samples[index]);
+    for (int block = firstBlock; block < lastBlock; block++) envelope.unite(envelopes[block]);
+
+    return envelope;
+}
+
+
+
+SegmentStore::Envelope SegmentStore::envelope(int segment, int first, int count) const
+{
+    if (segment < 0 || segment >= segmentCount) return Envelope::empty();
+
+    updateEnvelopes();
+    return span(samples.constData() + (qint64) segment * segmentLength,
+                blocks.constData() + (qint64) segment * blocksPerSegment, segmentLength, first, count);
+}
+
+
+
+SegmentStore::Envelope SegmentStore::overlayEnvelope(int first, int count) const
+{
+    if (segmentCount == 0) return Envelope::empty();
+
+    updateEnvelopes();
+    return span(overlaySamples.constData(), overlayBlocks.constData(), segmentLength, first, count);
+}
@@ -0,0 +1,68 @@
+#ifndef SEGMENTSTORE_H
+#define SEGMENTSTORE_H
+
+#include <QVector>
+#include <QtGlobal>
+
+#include "samplestore.h"
+
+class SegmentStore
+{
+
+    // The segment store implements segmented acquisition memory: many short triggered records,
+    // or segments, of identical length stored back to back in an arena that is allocated once
+    // up front. Re-arming for the next trigger merely hands out the next slot of the arena, so
+    // no allocation ever takes place while acquiring. Every segment carries the time stamp of
+    // its trigger, in nanoseconds since an arbitrary epoch, which allows rare and widely spaced
+    // events to be captured without having to keep the dead time in between.
+
+    // Committing a segment only records its time stamp. The envelopes of its blocks, and the
+    // overlay, i.e., the union of all segments recorded so far, are brought up to date lazily
+    // the next time an envelope is asked for, such that the work is done on the reader side and
+    // all segments can be drawn at once at the cost of drawing a single one.
+
+public:
+    typedef SampleStore::Envelope Envelope;
+
+    SegmentStore(int length, int capacity);
+    static int clampedLength(int length);
+    static int clampedCapacity(int length, int capacity);
+
+    void clear();
+    qint16 *arm();
+    void commit(qint64 timestamp);                  // in nanoseconds.
+    bool record(const qint16 *samples, qint64 timestamp);
+
+    const qint16 *segment(int segment) const;
+    Envelope envelope(int segment, int first, int count) const;
+    Envelope overlayEnvelope(int first, int count) const;
+
+    int count() const { return segmentCount; }
+    int capacity() const { return segmentCapacity; }
+    int length() const { return segmentLength; }
+    bool isFull() const { return segmentCount == segmentCapacity; }
+    qint64 timestamp(int segment) const { return timestamps.at(segment); }
+
+    const static int blockLength = SampleStore::blockLength;
+    const static int maximumArenaLength = 1 << 29;     // in samples, i.e., 1 GiB.
+
+private:
+    void updateEnvelopes() const;
+
+    template <typename Sample>
+    static Envelope span(const Sample *samples, const Envelope *envelopes, int length, int first, int count);
+
+    int segmentLength;
+    int segmentCapacity;
+    int blocksPerSegment;
+    int segmentCount;
+    mutable int envelopedCount;         // segments whose envelopes are up to date.
+
+    QVector<qint16> samples;            // segmentCapacity segments of segmentLength samples.
+    QVector<qint64> timestamps;
+    mutable QVector<Envelope> blocks;           // blocksPerSegment envelopes per segment.
+    mutable QVector<Envelope> overlaySamples;   // the union of all segments, sample by sample,
+    mutable QVector<Envelope> overlayBlocks;    // and block by block.
+};
+
+#endif // SEGMENTSTORE_H
@@ -0,0 +1,21 @@
+#-------------------------------------------------
+#
+# Unit tests of the sample store.
+#
+#-------------------------------------------------
+
+QT       += testlib
+QT       -= gui
+
+TARGET = tst_samplestore
+CONFIG   += console testcase
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+INCLUDEPATH += ../..
+
+SOURCES += tst_samplestore.cpp \
+    ../../samplestore.cpp
+
+HEADERS  += ../../samplestore.h
@@ -0,0 +1,170 @@
+#include <QtTest>
+
+#include <algorithm>
+
+#include "samplestore.h"
+
+class SampleStoreTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void roundTrip_data();
+    void roundTrip();
+    void envelope();
+    void memoryUsage_data();
+    void memoryUsage();
+
+private:
+    static quint32 random();
+    static quint32 seed;
+};
+
+// A plain linear congruential generator, such that the signals are the same on every run
+// and every platform, and do not depend on the deprecated qrand().
+
+quint32 SampleStoreTest::seed = 2014;
+
+quint32 SampleStoreTest::random()
+{
+    seed = seed * 1664525u + 1013904223u;
+    return seed >> 16;
+}
+
+
+
+void SampleStoreTest::roundTrip_data()
+{
+
+    // Every signal spans several chunks plus a partial one, such that both sealed and pending
+    // samples are read back. The signals are chosen to hit every encoding of a block: flatlines
+    // of zero bit width, ramps that the linear predictor reduces to nothing, noise that packs
+    // into a few bits, edges that become exceptions, and full-scale noise that is stored raw.
+
+    QTest::addColumn<QVector<qint16> >("samples");
+    QTest::addColumn<bool>("isCompressed");
+
+    const int count = 5 * SampleStore::chunkLength + 123;
+    QVector<qint16> constant(count), ramp(count), noisy(count), noise(count), rails(count);
+    seed = 2014;
+
+    for (int index = 0; index < count; index++) {
+        constant[index] = -1234;
+        ramp[index] = (qint16) (index * 7 - 20000);
+        noisy[index] = (qint16) (8000 * qSin(index * 0.001) + random() % 64);
+        noise[index] = (qint16) random();
+        rails[index] = (index / 100) % 2 ? 32767 : -32767; }
+
+    for (int compressed = 0; compressed < 2; compressed++) {
+        QByteArray suffix = compressed ? " (compressed)" : " (raw)";
+        QTest::newRow("constant" + suffix) << constant << (bool) compressed;
+        QTest::newRow("ramp" + suffix) << ramp << (bool) compressed;
+        QTest::newRow("noisy" + suffix) << noisy << (bool) compressed;
+        QTest::newRow("noise" + suffix) << noise << (bool) compressed;
+        QTest::newRow("rails" + suffix) << rails << (bool) compressed; }
+
+}
+
+
+
+void SampleStoreTest::roundTrip()
+{
+    QFETCH(QVector<qint16>, samples);
+    QFETCH(bool, isCompressed);
+
+    // Append in odd-sized pieces, so that appends straddle block and chunk boundaries.
+
+    SampleStore store(isCompressed);
+    for (int first = 0; first < samples.count(); first += 777)
+        store.append(samples.constData() + first, qMin(777, samples.count() - first));
+    QCOMPARE(store.count(), (qint64) samples.count());
+
+    QVector<qint16> decoded(samples.count());
+    QCOMPARE(store.read(0, decoded.count(), decoded.data()), samples.count());
+    QCOMPARE(decoded, samples);
+
+    // Reading back in reverse order of chunks cycles the decoded-chunk cache.
+
+    for (int first = samples.count() - 100; first >= 0; first -= SampleStore::chunkLength) {
+        qint16 sample;
+        QCOMPARE(store.read(first, 1, &sample), 1);
+        QCOMPARE(sample, samples.at(first)); }
+
+}
+
+
+
+void SampleStoreTest::envelope()
+{
+
+    // Random ranges, most of which start and end in the middle of a block, such that the head
+    // and the tail are scanned and the blocks in between are looked up at various levels of
+    // the pyramid. Some ranges also reach into the pending samples or past the end.
+
+    const int count = 37 * SampleStore::chunkLength + 555;
+    QVector<qint16> samples(count);
+    seed = 1977;
+
+    for (int index = 0; index < count; index++)
+        samples[index] = (qint16) (12000 * qSin(index * 0.0003) + random() % 256 +
+                                   (random() % 5000 == 0 ? 15000 : 0));
+
+    SampleStore store;
+    store.append(samples.constData(), count);
+
+    for (int round = 0; round < 2000; round++) {
+        qint64 first = random() % count, length = round % 2 ? random() % 300 : random() % (2 * count);
+        qint64 last = qMin(first + length, (qint64) count);
+        SampleStore::Envelope envelope = store.envelope(first, length);
+
+        if (first == last) {
+            QVERIFY(envelope.isEmpty());
+            continue; }
+
+        QCOMPARE(envelope.minimum, *std::min_element(samples.constBegin() + first, samples.constBegin() + last));
+        QCOMPARE(envelope.maximum, *std::max_element(samples.constBegin() + first, samples.constBegin() + last)); }
+
+}
+
+
+
+void SampleStoreTest::memoryUsage_data()
+{
+
+    // Typical signals with their expected minimum gain in capacity, measured against storing
+    // two bytes per sample, and including everything the store keeps, the pyramid in particular.
+
+    QTest::addColumn<QVector<qint16> >("samples");
+    QTest::addColumn<double>("minimumRatio");
+
+    const int count = 1 << 20;
+    QVector<qint16> sine(count), square(count), steps(count);
+    seed = 42;
+
+    for (int index = 0; index < count; index++) {
+        sine[index] = (qint16) (8000 * qSin(index * 0.001) + random() % 4);
+        square[index] = (index / 100) % 2 ? 3000 : -3000;
+        steps[index] = (qint16) (((index / 1000) % 2 ? 3000 : -3000) + (int) (random() % 4)); }
+
+    QTest::newRow("sine with 2 bits of noise") << sine << 3.0;
+    QTest::newRow("square wave") << square << 5.0;
+    QTest::newRow("steps with 2 bits of noise") << steps << 3.0;
+}
+
+
+
+void SampleStoreTest::memoryUsage()
+{
+    QFETCH(QVector<qint16>, samples);
+    QFETCH(double, minimumRatio);
+
+    SampleStore store;
+    store.append(samples.constData(), samples.count());
+
+    double ratio = 2.0 * samples.count() / store.memoryUsage();
+    QVERIFY2(ratio >= minimumRatio, qPrintable(QString("ratio %1").arg(ratio)));
+}
+
+QTEST_APPLESS_MAIN(SampleStoreTest)
+
+#include "tst_samplestore.moc"
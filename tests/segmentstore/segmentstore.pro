@@ -0,0 +1,22 @@
+#-------------------------------------------------
+#
+# Unit tests of the segment store.
+#
+#-------------------------------------------------
+
+QT       += testlib
+QT       -= gui
+
+TARGET = tst_segmentstore
+CONFIG   += console testcase
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+INCLUDEPATH += ../..
+
+SOURCES += tst_segmentstore.cpp \
+    ../../segmentstore.cpp
+
+HEADERS  += ../../samplestore.h \
+    ../../segmentstore.h
@@ -0,0 +1,221 @@
+#include <QtTest>
+
+#include "segmentstore.h"
+
+class SegmentStoreTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void envelope_data();
+    void envelope();
+    void lazyEnvelopes();
+    void clear();
+    void capacity();
+    void arm();
+    void full();
+
+private:
+    static quint32 random();
+    static quint32 seed;
+    static QVector<qint16> randomSegment(int length);
+    static void verify(const SegmentStore& store, const QVector<QVector<qint16> >& segments);
+};
+
+// A plain linear congruential generator, such that the segments are the same on every run.
+
+quint32 SegmentStoreTest::seed = 2014;
+
+quint32 SegmentStoreTest::random()
+{
+    seed = seed * 1664525u + 1013904223u;
+    return seed >> 16;
+}
+
+
+
+QVector<qint16> SegmentStoreTest::randomSegment(int length)
+{
+    QVector<qint16> segment(length);
+    for (int index = 0; index < length; index++) segment[index] = (qint16) random();
+    return segment;
+}
+
+
+
+void SegmentStoreTest::verify(const SegmentStore& store, const QVector<QVector<qint16> >& segments)
+{
+
+    // Compares the envelopes of every segment, and those of the overlay, against brute force,
+    // over all ranges that start and end at a handful of interesting offsets: the edges of the
+    // segment, the edges of blocks, just inside them, and just outside the segment.
+
+    int length = store.length();
+    QVector<int> offsets;
+    offsets << -3 << 0 << 1 << length - 1 << length << length + 3;
+    for (int block = SegmentStore::blockLength; block < length; block += SegmentStore::blockLength)
+        offsets << block - 1 << block << block + 1;
+
+    QCOMPARE(store.count(), segments.count());
+
+    for (int segment = -1; segment < segments.count(); segment++)
+        foreach (int first, offsets) foreach (int last, offsets) {
+            SegmentStore::Envelope expected = SegmentStore::Envelope::empty();
+            for (int index = qMax(first, 0); index < qMin(last, length); index++)
+                for (int other = 0; other < segments.count(); other++)
+                    if (segment == -1 || segment == other) expected.unite(segments.at(other).at(index));
+
+            SegmentStore::Envelope actual = segment == -1 ?
+                store.overlayEnvelope(first, last - first) : store.envelope(segment, first, last - first);
+
+            QCOMPARE(actual.isEmpty(), expected.isEmpty());
+            if (expected.isEmpty()) continue;
+            QCOMPARE(actual.minimum, expected.minimum);
+            QCOMPARE(actual.maximum, expected.maximum); }
+
+}
+
+
+
+void SegmentStoreTest::envelope_data()
+{
+
+    // Lengths below one block, of whole blocks, and with a partial last block.
+
+    QTest::addColumn<int>("length");
+
+    QTest::newRow("shorter than a block") << SegmentStore::blockLength / 2 - 1;
+    QTest::newRow("whole blocks") << 3 * SegmentStore::blockLength;
+    QTest::newRow("partial last block") << 3 * SegmentStore::blockLength + 17;
+}
+
+
+
+void SegmentStoreTest::envelope()
+{
+    QFETCH(int, length);
+
+    SegmentStore store(length, 8);
+    QVector<QVector<qint16> > segments;
+
+    for (int segment = 0; segment < 5; segment++) {
+        segments << randomSegment(length);
+        QVERIFY(store.record(segments.last().constData(), segment * 1000)); }
+
+    verify(store, segments);
+    QCOMPARE(store.timestamp(3), (qint64) 3000);
+}
+
+
+
+void SegmentStoreTest::lazyEnvelopes()
+{
+
+    // The envelopes are brought up to date by the reader, so interleave reading with committing
+    // to make sure that segments committed after a read are still taken into account.
+
+    const int length = 2 * SegmentStore::blockLength + 5;
+    SegmentStore store(length, 16);
+    QVector<QVector<qint16> > segments;
+
+    for (int round = 0; round < 4; round++) {
+        for (int segment = 0; segment <= round; segment++) {
+            segments << randomSegment(length);
+            QVERIFY(store.record(segments.last().constData(), segments.count())); }
+        verify(store, segments); }
+
+}
+
+
+
+void SegmentStoreTest::clear()
+{
+
+    // After clearing, the overlay must only reflect the segments recorded afterwards, even
+    // if they lie entirely within the extremes of those recorded before.
+
+    const int length = SegmentStore::blockLength + 9;
+    SegmentStore store(length, 4);
+    QVector<QVector<qint16> > segments;
+
+    QVector<qint16> extremes(length, 32767);
+    extremes[0] = -32768;
+    QVERIFY(store.record(extremes.constData(), 0));
+    QCOMPARE(store.overlayEnvelope(0, length).maximum, (qint16) 32767);
+
+    store.clear();
+    QCOMPARE(store.count(), 0);
+    QVERIFY(store.overlayEnvelope(0, length).isEmpty());
+
+    for (int segment = 0; segment < 2; segment++) {
+        segments << QVector<qint16>(length, (qint16) (segment * 100 - 50));
+        QVERIFY(store.record(segments.last().constData(), segment)); }
+
+    verify(store, segments);
+}
+
+
+
+void SegmentStoreTest::capacity()
+{
+
+    // The arena never exceeds its maximum length; the capacity is reduced instead. Checked on
+    // the clamping itself, since a store that actually hits the limit takes a gigabyte.
+
+    QCOMPARE(SegmentStore::clampedLength(300000), 300000);
+    QCOMPARE(SegmentStore::clampedCapacity(300000, 5000), SegmentStore::maximumArenaLength / 300000);
+    QCOMPARE(SegmentStore::clampedCapacity(300000, 1000), 1000);
+    QCOMPARE(SegmentStore::clampedLength(INT_MAX), (int) SegmentStore::maximumArenaLength);
+    QCOMPARE(SegmentStore::clampedCapacity(INT_MAX, 2), 1);
+
+    SegmentStore store(1000, 2000);
+    QCOMPARE(store.length(), 1000);
+    QCOMPARE(store.capacity(), 2000);
+
+    SegmentStore degenerate(0, 0);
+    QCOMPARE(degenerate.length(), 1);
+    QCOMPARE(degenerate.capacity(), 1);
+}
+
+
+
+void SegmentStoreTest::arm()
+{
+
+    // Arming without committing hands out the same slot again, and nothing is recorded.
+
+    SegmentStore store(10, 3);
+    qint16 *slot = store.arm();
+    QVERIFY(slot != 0);
+    QCOMPARE(store.arm(), slot);
+    QCOMPARE(store.count(), 0);
+
+    for (int index = 0; index < 10; index++) slot[index] = (qint16) index;
+    store.commit(42);
+    QCOMPARE(store.count(), 1);
+    QVERIFY(store.arm() != slot);
+    QCOMPARE(store.segment(0), (const qint16 *) slot);
+    QCOMPARE(store.envelope(0, 0, 10).maximum, (qint16) 9);
+}
+
+
+
+void SegmentStoreTest::full()
+{
+    SegmentStore store(10, 2);
+    QVector<qint16> segment(10, 7);
+
+    QVERIFY(store.record(segment.constData(), 1));
+    QVERIFY(store.record(segment.constData(), 2));
+    QVERIFY(store.isFull());
+    QVERIFY(store.arm() == 0);
+    QVERIFY(!store.record(segment.constData(), 3));
+
+    store.commit(4);
+    QCOMPARE(store.count(), 2);
+    QCOMPARE(store.timestamp(1), (qint64) 2);
+}
+
+QTEST_APPLESS_MAIN(SegmentStoreTest)
+
+#include "tst_segmentstore.moc"